@@ -3,60 +3,678 @@
  * \brief  Q[Rg[[͊ǗiWinMMŁj
  *********************************************************************/
 #include "game_controller.h"
+#include "input_task.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 
 // ÓIoϐ̒`
 int GameController::s_workingControllerId = -1;
 GamepadState GameController::s_currentState = {};
 GamepadState GameController::s_prevState = {};
 GamepadCaps GameController::s_caps = {};
+QuantizedInput GameController::s_currentInput = {};
+bool GameController::s_deterministic = false;
+GameController::VirtualButtonSlot GameController::s_virtualButtons[MAX_VIRTUAL_BUTTONS] = {};
+int GameController::s_numVirtualButtons = 0;
+std::thread GameController::s_probeThreads[PROBE_WORKERS];
+std::atomic<int> GameController::s_probeNext(0);
+std::atomic<unsigned int> GameController::s_probeDoneMask(0);
+std::atomic<int> GameController::s_probeRunning(0);
+std::mutex GameController::s_probeMutex;
+std::condition_variable GameController::s_probeCond;
+std::atomic<unsigned int> GameController::s_probeFoundMask(0);
+GamepadCaps GameController::s_probeCaps[MAX_CONTROLLERS] = {};
+bool GameController::s_probing = false;
+bool GameController::s_probeConsumed = false;
+unsigned int GameController::s_probeStartTime = 0;
+char GameController::s_cachePath[MAX_PATH] = {};
+int GameController::s_cachedControllerId = -1;
+GamepadCaps GameController::s_cachedCaps = {};
+std::thread GameController::s_capsThread;
+GamepadCaps GameController::s_pendingCaps = {};
+int GameController::s_pendingCapsId = -1;
+std::atomic<bool> GameController::s_capsReady(false);
+bool GameController::s_driftCompensation = true;
+StickDriftStats GameController::s_stickDrift[NUM_STICKS] = {};
+LatchMode GameController::s_latchMode = LATCH_MODE_OFF;
+GamepadState GameController::s_latchedState = {};
+LatchStats GameController::s_latchStats[MAX_LATCH_POINTS] = {};
+int GameController::s_numLatchPoints = 0;
+LARGE_INTEGER GameController::s_frameSampleTime = {};
+LARGE_INTEGER GameController::s_latchSampleTime = {};
+double GameController::s_usPerTick = 0.0;
+
+// Finalize()Ă΂ɏIĂAXbhjOɏI҂
+// i̐ÓIoɒ`āAɔj悤ɂj
+static struct GameControllerExitGuard {
+    ~GameControllerExitGuard() { GameController::Finalize(); }
+} s_exitGuard;
+
+// LbVt@C̓e
+struct GamepadCacheData {
+    unsigned int magic;
+    unsigned int size;
+    int controllerId;
+    GamepadCaps caps;
+};
+static const unsigned int GAMEPAD_CACHE_MAGIC = 0x31435047; // "GPC1"
+
+// 
+bool GameController::Initialize(const char* pCachePath) {
+    JoinThreads();
+
+    s_workingControllerId = -1;
+    s_currentState = {};
+    s_prevState = {};
+    s_caps = {};
+    s_currentInput = {};
+    ResetVirtualButtons();
+    ResetDriftEstimate();
+
+    // JE^̎g͋NɕςȂ̂ňx擾
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    s_usPerTick = 1000000.0 / (double)freq.QuadPart;
+
+    s_probeStartTime = 0;
+    s_probeConsumed = false;
+    s_cachedControllerId = -1;
+    s_cachedCaps = {};
+
+    // OIDƃfoCXǂݍ
+    s_cachePath[0] = '\0';
+    if (pCachePath != nullptr) {
+        std::strncpy(s_cachePath, pCachePath, MAX_PATH - 1);
+        s_cachePath[MAX_PATH - 1] = '\0';
+        LoadCache();
+    }
+    return true;
+}
+
+// I
+void GameController::Finalize() {
+    JoinThreads();
+
+    s_workingControllerId = -1;
+    s_currentState = {};
+    s_prevState = {};
+    s_caps = {};
+    s_currentInput = {};
+}
+
+// ␳̐ݒ
+void GameController::SetDriftCompensation(bool enable) {
+    s_driftCompensation = enable;
+    ResetDriftEstimate();
+}
+
+// 蒼
+void GameController::ResetDriftEstimate() {
+    for (int i = 0; i < NUM_STICKS; i++) {
+        s_stickDrift[i] = {};
+    }
+}
+
+// S̐XV
+// wړςōXV̂ŁATv𗭂߂ɖt[̏ʂōς
+void GameController::UpdateDrift(StickDriftStats* pDrift, int rawX, int rawY, bool buttonsIdle) {
+    const float RECENT_RATE = 0.1f;         // Î~p̕ς̍XV
+    const float REST_RATE = 0.01f;          // S̍XV
+    const float REST_VARIANCE = 0.0004f;    // ȉ̂΂ȂÎ~iW΍0.02j
+    const float LEARN_RADIUS = 0.3f;        // 蒆̒S炱ȏ㗣Ă瑀쒆
+    const unsigned int MIN_REST_FRAMES = 30;    // S𓮂܂łɐÎ~t[
+    const unsigned int MIN_HOLD_FRAMES = 600;   // fbh][̊OŎ~܂Ăꍇi10bj
+    const unsigned int MIN_REST_SAMPLES = 120;  // fbh][ς܂ł̃Tv
+    const float NOISE_SCALE = 4.0f;         // fbh][͂΂̉{ɂ邩
+    const float DEADZONE_MIN = 0.05f;
+    const float DEADZONE_MAX = 0.30f;
+
+    float x = (float)(rawX - 32767) / 32767.0f;
+    float y = (float)(rawY - 32767) / 32767.0f;
+
+    // ߂̕ςƕU
+    float dx = x - pDrift->recentMeanX;
+    float dy = y - pDrift->recentMeanY;
+    pDrift->recentMeanX += RECENT_RATE * dx;
+    pDrift->recentMeanY += RECENT_RATE * dy;
+    pDrift->recentVariance = (1.0f - RECENT_RATE) *
+        (pDrift->recentVariance + RECENT_RATE * (dx * dx + dy * dy) * 0.5f);
+
+    // Î~ifbh][傫ȂwKł悤A͈͂̓fbh][Ƃ͕ʂɌ߂j
+    float cx = x - pDrift->centerX;
+    float cy = y - pDrift->centerY;
+    pDrift->resting = buttonsIdle &&
+        pDrift->recentVariance < REST_VARIANCE &&
+        fabs(cx) < LEARN_RADIUS && fabs(cy) < LEARN_RADIUS;
+    if (!pDrift->resting) {
+        pDrift->restFrames = 0;
+        return;
+    }
+
+    // ΂炭Î~܂ł͒S𓮂Ȃ
+    // fbh][̊O͈Ӑ}ē|Ă邱Ƃ̂ŁAƒ҂
+    bool inDeadzone = fabs(cx) < pDrift->deadzone && fabs(cy) < pDrift->deadzone;
+    unsigned int minFrames = inDeadzone ? MIN_REST_FRAMES : MIN_HOLD_FRAMES;
+    if (pDrift->restFrames < minFrames) {
+        pDrift->restFrames++;
+        return;
+    }
+
+    // SƐÎ~̂΂XV
+    pDrift->centerX += REST_RATE * cx;
+    pDrift->centerY += REST_RATE * cy;
+    pDrift->restVariance += REST_RATE * (pDrift->recentVariance - pDrift->restVariance);
+    pDrift->noise = sqrtf(pDrift->restVariance);
+    pDrift->restSamples++;
+
+    // \ȃTv܂fbh][΂ɍ킹
+    if (pDrift->restSamples >= MIN_REST_SAMPLES) {
+        float deadzone = pDrift->noise * NOISE_SCALE + DEADZONE_MIN;
+        if (deadzone > DEADZONE_MAX) deadzone = DEADZONE_MAX;
+        pDrift->deadzone = deadzone;
+    }
+}
+
+// b`|Cgo^
+int GameController::RegisterLatchPoint(const char* pName) {
+    if (s_numLatchPoints >= MAX_LATCH_POINTS) return -1;
+
+    int index = s_numLatchPoints++;
+    s_latchStats[index] = {};
+    if (pName != nullptr) {
+        std::strncpy(s_latchStats[index].name, pName, sizeof(s_latchStats[index].name) - 1);
+    }
+    return index;
+}
+
+// vʂZbg
+void GameController::ResetLatchStats() {
+    for (int i = 0; i < s_numLatchPoints; i++) {
+        LatchStats& stats = s_latchStats[i];
+        stats.count = 0;
+        stats.resampleCount = 0;
+        stats.totalFrameAgeUs = 0.0;
+        stats.totalLatchedAgeUs = 0.0;
+        stats.maxSavedUs = 0.0;
+    }
+}
+
+// ŐV̏Ԃ擾
+const GamepadState& GameController::Latch(int latchId) {
+    if (!s_currentState.connected) return s_currentState;
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    // t[ŏ߂Ẵb`Ȃt[Jn̏Ԃn߂
+    if (s_latchSampleTime.QuadPart == s_frameSampleTime.QuadPart) {
+        s_latchedState = s_currentState;
+    }
+
+    // Ōɓǂ񂾒l\V΂g
+    bool resampled = false;
+    double latchedAgeUs = (double)(now.QuadPart - s_latchSampleTime.QuadPart) * s_usPerTick;
+    if (s_latchMode == LATCH_MODE_RESAMPLE && latchedAgeUs >= LATCH_MIN_RESAMPLE_US) {
+        // ʎql͕\pɂ͎gȂ̂Ŏ̂Ă
+        JOYINFOEX ji;
+        QuantizedInput discarded;
+        if (ReadRaw(s_workingControllerId, &ji)) {
+            DecodeAxes(ji, &s_latchedState, &discarded);
+            QueryPerformanceCounter(&s_latchSampleTime);
+            latchedAgeUs = 0.0;
+            resampled = true;
+        }
+    }
+
+    // vit[Jn̒lƔׂĂǂꂾVj
+    if (latchId >= 0 && latchId < s_numLatchPoints) {
+        LatchStats& stats = s_latchStats[latchId];
+        double frameAgeUs = (double)(now.QuadPart - s_frameSampleTime.QuadPart) * s_usPerTick;
+        double savedUs = frameAgeUs - latchedAgeUs;
+        stats.count++;
+        if (resampled) stats.resampleCount++;
+        stats.totalFrameAgeUs += frameAgeUs;
+        stats.totalLatchedAgeUs += latchedAgeUs;
+        if (savedUs > stats.maxSavedUs) stats.maxSavedUs = savedUs;
+    }
+
+    return (s_latchMode == LATCH_MODE_OFF) ? s_currentState : s_latchedState;
+}
+
+// t[Ă
+void GameController::Update() {
+    UpdateState();
+
+    // ͑҂̃R[`ĊJ
+    InputAwait::Dispatch(s_currentState.buttonMask, s_prevState.buttonMask, timeGetTime());
+}
+
+// Xbh̏I҂
+void GameController::JoinThreads() {
+    for (int i = 0; i < PROBE_WORKERS; i++) {
+        if (s_probeThreads[i].joinable()) s_probeThreads[i].join();
+    }
+    s_probing = false;
+
+    if (s_capsThread.joinable()) s_capsThread.join();
+    s_capsReady = false;
+}
+
+// LbVǂݍ
+void GameController::LoadCache() {
+    FILE* pFile = std::fopen(s_cachePath, "rb");
+    if (pFile == nullptr) return;
+
+    GamepadCacheData data;
+    size_t read = std::fread(&data, sizeof(data), 1, pFile);
+    std::fclose(pFile);
+
+    // `ႦΎgȂ
+    if (read != 1 || data.magic != GAMEPAD_CACHE_MAGIC || data.size != sizeof(data)) return;
+    if (data.controllerId < 0 || data.controllerId >= MAX_CONTROLLERS) return;
+
+    s_cachedControllerId = data.controllerId;
+    s_cachedCaps = data.caps;
+}
+
+// LbV
+void GameController::SaveCache() {
+    if (s_cachePath[0] == '\0' || s_workingControllerId == -1 || !s_caps.valid) return;
+
+    // pfBO܂߂0Ŗ߂Ă珑o
+    GamepadCacheData data;
+    std::memset(static_cast<void*>(&data), 0, sizeof(data));
+    data.magic = GAMEPAD_CACHE_MAGIC;
+    data.size = sizeof(data);
+    data.controllerId = s_workingControllerId;
+    data.caps = s_caps;
+
+    FILE* pFile = std::fopen(s_cachePath, "wb");
+    if (pFile == nullptr) return;
+    std::fwrite(&data, sizeof(data), 1, pFile);
+    std::fclose(pFile);
+}
+
+// TXbh̏
+void GameController::ProbeWorker() {
+    for (;;) {
+        int id = s_probeNext.fetch_add(1);
+        if (id >= MAX_CONTROLLERS) break;
+
+        // ΃foCX̃XbhŎ擾Ă
+        if (GetGamepadValue(id, 3) != -1 && QueryCaps(id, &s_probeCaps[id])) {
+            s_probeFoundMask.fetch_or(1u << id);
+        }
+        {
+            std::lock_guard<std::mutex> lock(s_probeMutex);
+            s_probeDoneMask.fetch_or(1u << id);
+        }
+        s_probeCond.notify_all();
+    }
+    s_probeRunning.fetch_sub(1);
+}
+
+// SID̕TJn
+void GameController::StartProbe() {
+    s_probeNext = 0;
+    s_probeDoneMask = 0;
+    s_probeFoundMask = 0;
+    s_probeRunning = PROBE_WORKERS;
+    s_probing = true;
+    s_probeConsumed = false;
+    s_probeStartTime = timeGetTime();
+
+    for (int i = 0; i < PROBE_WORKERS; i++) {
+        s_probeThreads[i] = std::thread(ProbeWorker);
+    }
+}
+
+// TʂmF
+// TƓłIDIԂ߁A菬ID𒲂׏I܂ő҂
+int GameController::PollProbe(unsigned int waitMs) {
+    const unsigned int ALL_IDS = (1u << MAX_CONTROLLERS) - 1;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitMs);
+
+    // 1׏I邽тɒʒm̂ŁA܂ŃXbh~߂đ҂
+    int result = -1;
+    std::unique_lock<std::mutex> lock(s_probeMutex);
+    s_probeCond.wait_until(lock, deadline, [&result]() {
+        unsigned int found = s_probeFoundMask.load();
+        unsigned int done = s_probeDoneMask.load();
+
+        if (found != 0) {
+            unsigned int lowest = found & (0u - found);
+            if ((done & (lowest - 1)) == lowest - 1) {
+                for (result = 0; (lowest >> result) != 1; result++) {}
+                return true;
+            }
+        }
+        return done == ALL_IDS;
+    });
+    return result;
+}
+
+// ITXbh
+// cID𒲂׏I܂œĂ̂ŁAt[mF
+void GameController::ReapProbeThreads() {
+    if (!s_probing || s_probeRunning.load() != 0) return;
+
+    for (int i = 0; i < PROBE_WORKERS; i++) {
+        if (s_probeThreads[i].joinable()) s_probeThreads[i].join();
+    }
+    s_probing = false;
+}
+
+// foCX̔񓯊擾Jn
+void GameController::StartCapsQuery(int id) {
+    if (s_capsThread.joinable()) s_capsThread.join();
+
+    s_capsReady = false;
+    s_pendingCapsId = id;
+    s_capsThread = std::thread([id]() {
+        QueryCaps(id, &s_pendingCaps);
+        s_capsReady = true;
+    });
+}
+
+// 񓯊擾foCX𔽉f
+void GameController::ApplyPendingCaps() {
+    if (!s_capsReady.load()) return;
+
+    s_capsThread.join();
+    s_capsReady = false;
+
+    // 擾ɐؒfĕʂIDɕςĂ̂Ă
+    int id = s_pendingCapsId;
+    s_pendingCapsId = -1;
+    if (id == s_workingControllerId && s_pendingCaps.valid) {
+        s_caps = s_pendingCaps;
+        SaveCache();
+    }
+}
+
+// Rg[[T
+bool GameController::FindController() {
+    // OIDŏɎifoCX̓LbVgAŎ蒼j
+    if (s_cachedControllerId != -1) {
+        int id = s_cachedControllerId;
+        s_cachedControllerId = -1;
+        if (GetGamepadValue(id, 3) != -1) {
+            s_workingControllerId = id;
+            s_caps = s_cachedCaps;
+            StartCapsQuery(id);
+
+            // ʂ̃Rg[[Ȃ̂Ő͂蒼
+            ResetDriftEstimate();
+            return true;
+        }
+    }
+
+    // SIDɒׂiTn߂t[҂j
+    unsigned int waitMs = 0;
+    if (!s_probing) {
+        if (s_probeStartTime != 0 && timeGetTime() - s_probeStartTime < PROBE_INTERVAL_MS) return false;
+        StartProbe();
+        waitMs = PROBE_DEADLINE_MS;
+    }
+    if (s_probeConsumed) return false;
+
+    int id = PollProbe(waitMs);
+    if (id == -1) return false;
+
+    s_probeConsumed = true;
+    s_workingControllerId = id;
+    s_caps = s_probeCaps[id];
+    SaveCache();
+
+    // ÕRg[[̒Sƃfbh][zȂ
+    ResetDriftEstimate();
+    return true;
+}
+
+// oCgɏo
+int QuantizedInput::Serialize(unsigned char* pBuf) const {
+    pBuf[0] = (unsigned char)(buttons & 0xFF);
+    pBuf[1] = (unsigned char)((buttons >> 8) & 0xFF);
+    pBuf[2] = (unsigned char)((buttons >> 16) & 0xFF);
+    pBuf[3] = (unsigned char)((buttons >> 24) & 0xFF);
+    pBuf[4] = (unsigned char)leftStickX;
+    pBuf[5] = (unsigned char)leftStickY;
+    pBuf[6] = (unsigned char)rightStickX;
+    pBuf[7] = (unsigned char)rightStickY;
+    pBuf[8] = triggerL;
+    pBuf[9] = triggerR;
+    return SERIALIZED_SIZE;
+}
+
+// oCg񂩂ǂݍ
+bool QuantizedInput::Deserialize(const unsigned char* pBuf, int size) {
+    if (size < SERIALIZED_SIZE) return false;
+
+    buttons = (unsigned int)pBuf[0] | ((unsigned int)pBuf[1] << 8) |
+        ((unsigned int)pBuf[2] << 16) | ((unsigned int)pBuf[3] << 24);
+    leftStickX = (signed char)pBuf[4];
+    leftStickY = (signed char)pBuf[5];
+    rightStickX = (signed char)pBuf[6];
+    rightStickY = (signed char)pBuf[7];
+    triggerL = pBuf[8];
+    triggerR = pBuf[9];
+    return true;
+}
+
+// GamepadStateɓWJ
+void QuantizedInput::ToState(GamepadState* pState) const {
+    pState->connected = true;
+    pState->leftStickX = (float)leftStickX / 127.0f;
+    pState->leftStickY = (float)leftStickY / 127.0f;
+    pState->rightStickX = (float)rightStickX / 127.0f;
+    pState->rightStickY = (float)rightStickY / 127.0f;
+    pState->triggerL = (float)triggerL / 255.0f;
+    pState->triggerR = (float)triggerR / 255.0f;
+    pState->SetButtonMask(buttons);
+}
+
+// XeBbN̐̒lʎqiẐ݁j
+signed char QuantizedInput::QuantizeStick(int raw, int center, int deadzone) {
+    int value = raw - center;
+    int magnitude = (value < 0) ? -value : value;
+
+    // S[܂ł32767ɂȂ悤БL΂
+    int limit = (value < 0) ? center : 65535 - center;
+    if (limit < 1) limit = 1;
+    if (limit != 32767) magnitude = magnitude * 32767 / limit;
+    if (magnitude > 32767) magnitude = 32767;
+    if (magnitude < deadzone) return 0;
+
+    // fbh][O0?127Ɋ蓖āiľܓj
+    int range = 32767 - deadzone;
+    int q = ((magnitude - deadzone) * 127 + range / 2) / range;
+    if (q > 127) q = 127;
+    return (signed char)((value < 0) ? -q : q);
+}
+
+// gK[̐̒lʎqiẐ݁j
+unsigned char QuantizedInput::QuantizeTrigger(int raw) {
+    if (raw < 0) raw = 0;
+    if (raw > 65535) raw = 65535;
+    return (unsigned char)((raw * 255 + 32767) / 65535);
+}
+
+// ZgK[̐̒lʎqiẐ݁j
+// 32767íjA65535L2A0R2
+void QuantizedInput::QuantizeCombinedTrigger(int raw, unsigned char* pL, unsigned char* pR) {
+    const int CENTER = 32767;
+    const int DEADZONE = 1000;
+
+    *pL = 0;
+    *pR = 0;
+    if (raw > CENTER + DEADZONE) {
+        int value = (raw > 65535) ? 65535 : raw;
+        *pL = (unsigned char)(((value - CENTER) * 255 + (65535 - CENTER) / 2) / (65535 - CENTER));
+    } else if (raw < CENTER - DEADZONE) {
+        int value = (raw < 0) ? 0 : raw;
+        *pR = (unsigned char)(((CENTER - value) * 255 + CENTER / 2) / CENTER);
+    }
+}
+
+// z{^̐ݒύX
+bool GameController::SetVirtualButton(int index, const VirtualButtonConfig& config) {
+    if (index < 0 || index >= s_numVirtualButtons) return false;
+    if (config.target < 0 || config.target >= GAMEPAD_BUTTON_COUNT) return false;
+    if (config.source < 0 || config.source >= VIRTUAL_SOURCE_COUNT) return false;
+    if (config.releaseThreshold > config.pressThreshold) return false;
+    if (config.stickWays != 0 && config.stickWays != 4 && config.stickWays != 8) return false;
+
+    VirtualButtonSlot& slot = s_virtualButtons[index];
+    slot.targetBit = (unsigned int)config.target;
+    slot.source = config.source;
+    slot.direction = (config.direction < 0.0f) ? -1.0f : 1.0f;
+    slot.pressThreshold = config.pressThreshold;
+    slot.releaseThreshold = config.releaseThreshold;
+    slot.minHoldMs = config.minHoldMs;
+    slot.pressTime = 0;
+    slot.on = 0;
+
+    // 鎲igK[͏0̘ggj
+    switch (config.source) {
+    case VIRTUAL_SOURCE_LEFT_X: slot.perpSource = VIRTUAL_SOURCE_LEFT_Y; break;
+    case VIRTUAL_SOURCE_LEFT_Y: slot.perpSource = VIRTUAL_SOURCE_LEFT_X; break;
+    case VIRTUAL_SOURCE_RIGHT_X: slot.perpSource = VIRTUAL_SOURCE_RIGHT_Y; break;
+    case VIRTUAL_SOURCE_RIGHT_Y: slot.perpSource = VIRTUAL_SOURCE_RIGHT_X; break;
+    default: slot.perpSource = VIRTUAL_SOURCE_COUNT; break;
+    }
+
+    // XeBbN͈̔
+    // 4́}45xA8͎΂߂ŗׂ̕ƏdȂ悤}67.5x
+    if (config.stickWays == 4) {
+        slot.axisWeight = 0.0f;
+        slot.cosHalf = 0.70710678f;
+    } else if (config.stickWays == 8) {
+        slot.axisWeight = 0.0f;
+        slot.cosHalf = 0.38268343f;
+    } else {
+        slot.axisWeight = 1.0f;
+        slot.cosHalf = -2.0f;
+    }
+    return true;
+}
+
+// z{^ǉ
+int GameController::AddVirtualButton(const VirtualButtonConfig& config) {
+    if (s_numVirtualButtons >= MAX_VIRTUAL_BUTTONS) return -1;
+
+    int index = s_numVirtualButtons++;
+    if (!SetVirtualButton(index, config)) {
+        s_numVirtualButtons--;
+        return -1;
+    }
+    return index;
+}
+
+// ̐ݒ肾ɖ߂
+void GameController::ResetVirtualButtons() {
+    s_numVirtualButtons = 0;
+
+    VirtualButtonConfig config;
+    config.target = GAMEPAD_BUTTON_L2;
+    config.source = VIRTUAL_SOURCE_TRIGGER_L;
+    AddVirtualButton(config);
+
+    config.target = GAMEPAD_BUTTON_R2;
+    config.source = VIRTUAL_SOURCE_TRIGGER_R;
+    AddVirtualButton(config);
+}
+
+// z{^𔻒肵ărbg}XNԂ
+// S{^𕪊Ȃ1̃[vŔ肷
+unsigned int GameController::EvaluateVirtualButtons(unsigned int now) {
+    // ͌̒liŌ̘g͒鎲Ȃꍇpɏ0j
+    float values[VIRTUAL_SOURCE_COUNT + 1] = {
+        s_currentState.leftStickX, s_currentState.leftStickY,
+        s_currentState.rightStickX, s_currentState.rightStickY,
+        s_currentState.triggerL, s_currentState.triggerR,
+        0.0f
+    };
+
+    unsigned int mask = 0;
+    for (int i = 0; i < s_numVirtualButtons; i++) {
+        VirtualButtonSlot& slot = s_virtualButtons[i];
+
+        // ̒lA܂̓XeBbŇXi͈͊OȂ0j
+        float axis = values[slot.source] * slot.direction;
+        float perp = values[slot.perpSource];
+        float radius = sqrtf(axis * axis + perp * perp);
+        float inSector = (float)(axis >= slot.cosHalf * radius);
+        float value = slot.axisWeight * axis + (1.0f - slot.axisWeight) * radius * inSector;
+
+        // qXeVXFI͗臒lŒIԂ𖞂Ԃ͈ێ
+        unsigned int holding = (unsigned int)(now - slot.pressTime < slot.minHoldMs);
+        unsigned int on = (unsigned int)(value >= slot.pressThreshold) |
+            (slot.on & ((unsigned int)(value > slot.releaseThreshold) | holding));
+
+        // IɂȂL^
+        unsigned int rising = on & ~slot.on;
+        slot.pressTime += (now - slot.pressTime) * rising;
+        slot.on = on;
+
+        mask |= on << slot.targetBit;
+    }
+    return mask;
+}
 
 // foCX擾
-void GameController::UpdateCaps(int id) {
+bool GameController::QueryCaps(int id, GamepadCaps* pCaps) {
     JOYCAPS jc;
     if (joyGetDevCaps(id, &jc, sizeof(JOYCAPS)) != JOYERR_NOERROR) {
-        s_caps.valid = false;
-        return;
+        pCaps->valid = false;
+        return false;
     }
 
-    s_caps.valid = true;
-    s_caps.manufacturerId = jc.wMid;
-    s_caps.productId = jc.wPid;
+    pCaps->valid = true;
+    pCaps->manufacturerId = jc.wMid;
+    pCaps->productId = jc.wPid;
 
     // iRs[
     for (int i = 0; i < 31 && jc.szPname[i] != '\0'; i++) {
-        s_caps.productName[i] = (char)jc.szPname[i];
+        pCaps->productName[i] = (char)jc.szPname[i];
     }
-    s_caps.productName[31] = '\0';
+    pCaps->productName[31] = '\0';
 
-    s_caps.numAxes = jc.wNumAxes;
-    s_caps.numButtons = jc.wNumButtons;
+    pCaps->numAxes = jc.wNumAxes;
+    pCaps->numButtons = jc.wNumButtons;
 
     // e͈̔
-    s_caps.xMin = jc.wXmin; s_caps.xMax = jc.wXmax;
-    s_caps.yMin = jc.wYmin; s_caps.yMax = jc.wYmax;
-    s_caps.zMin = jc.wZmin; s_caps.zMax = jc.wZmax;
-    s_caps.rMin = jc.wRmin; s_caps.rMax = jc.wRmax;
-    s_caps.uMin = jc.wUmin; s_caps.uMax = jc.wUmax;
-    s_caps.vMin = jc.wVmin; s_caps.vMax = jc.wVmax;
+    pCaps->xMin = jc.wXmin; pCaps->xMax = jc.wXmax;
+    pCaps->yMin = jc.wYmin; pCaps->yMax = jc.wYmax;
+    pCaps->zMin = jc.wZmin; pCaps->zMax = jc.wZmax;
+    pCaps->rMin = jc.wRmin; pCaps->rMax = jc.wRmax;
+    pCaps->uMin = jc.wUmin; pCaps->uMax = jc.wUmax;
+    pCaps->vMin = jc.wVmin; pCaps->vMax = jc.wVmax;
 
     // \L[̐
-    s_caps.numPov = (jc.wCaps & JOYCAPS_HASPOV) ? 1 : 0;
+    pCaps->numPov = (jc.wCaps & JOYCAPS_HASPOV) ? 1 : 0;
 
     // e̗L
-    s_caps.hasZ = (jc.wCaps & JOYCAPS_HASZ) != 0;
-    s_caps.hasR = (jc.wCaps & JOYCAPS_HASR) != 0;
-    s_caps.hasU = (jc.wCaps & JOYCAPS_HASU) != 0;
-    s_caps.hasV = (jc.wCaps & JOYCAPS_HASV) != 0;
-    s_caps.hasPov = (jc.wCaps & JOYCAPS_HASPOV) != 0;
+    pCaps->hasZ = (jc.wCaps & JOYCAPS_HASZ) != 0;
+    pCaps->hasR = (jc.wCaps & JOYCAPS_HASR) != 0;
+    pCaps->hasU = (jc.wCaps & JOYCAPS_HASU) != 0;
+    pCaps->hasV = (jc.wCaps & JOYCAPS_HASV) != 0;
+    pCaps->hasPov = (jc.wCaps & JOYCAPS_HASPOV) != 0;
+    return true;
+}
+
+// S̒l擾
+bool GameController::ReadRaw(int id, JOYINFOEX* pInfo) {
+    pInfo->dwSize = sizeof(JOYINFOEX);
+    pInfo->dwFlags = JOY_RETURNALL;
+    return joyGetPosEx(id, pInfo) == JOYERR_NOERROR;
 }
 
 // w肵̒l擾
 int GameController::GetGamepadValue(int id, int func) {
     JOYINFOEX ji;
-    ji.dwSize = sizeof(JOYINFOEX);
-    ji.dwFlags = JOY_RETURNALL;
-
-    if (joyGetPosEx(id, &ji) != JOYERR_NOERROR)
+    if (!ReadRaw(id, &ji))
         return -1;
 
     switch (func) {
@@ -72,41 +690,124 @@ int GameController::GetGamepadValue(int id, int func) {
     }
 }
 
+// XeBbNEgK[̒lϊ
+void GameController::DecodeAxes(const JOYINFOEX& ji, GamepadState* pState, QuantizedInput* pInput) {
+    int leftX = (int)ji.dwXpos;
+    int leftY = (int)ji.dwYpos;
+    int rightX = (int)ji.dwRpos;
+    int rightY = (int)ji.dwUpos;
+    int triggerZ = (int)ji.dwZpos;
+    int triggerV = (int)ji.dwVpos;
+
+    // fobOpɒlۑ
+    pState->axisLeftX = leftX;
+    pState->axisLeftY = leftY;
+    pState->axisRightX = rightX;
+    pState->axisRightY = rightY;
+    pState->axisTriggerL = triggerZ;
+    pState->axisTriggerR = triggerV;
+
+    // S␳iʎqpɐ̒l֕ϊj
+    const StickDriftStats& left = s_stickDrift[0];
+    const StickDriftStats& right = s_stickDrift[1];
+    int leftCenterX = 32767 + (int)lroundf(left.centerX * 32767.0f);
+    int leftCenterY = 32767 + (int)lroundf(left.centerY * 32767.0f);
+    int rightCenterX = 32767 + (int)lroundf(right.centerX * 32767.0f);
+    int rightCenterY = 32767 + (int)lroundf(right.centerY * 32767.0f);
+    int leftDeadzone = (int)lroundf(left.deadzone * 32767.0f);
+    int rightDeadzone = (int)lroundf(right.deadzone * 32767.0f);
+
+    // ʎqiẐ݂Ȃ̂Ŋɂ炸vj
+    pInput->leftStickX = QuantizedInput::QuantizeStick(leftX, leftCenterX, leftDeadzone);
+    pInput->leftStickY = QuantizedInput::QuantizeStick(leftY, leftCenterY, leftDeadzone);
+    pInput->rightStickX = QuantizedInput::QuantizeStick(rightX, rightCenterX, rightDeadzone);
+    pInput->rightStickY = QuantizedInput::QuantizeStick(rightY, rightCenterY, rightDeadzone);
+    if (s_caps.hasV) {
+        pInput->triggerL = QuantizedInput::QuantizeTrigger(triggerZ);
+        pInput->triggerR = QuantizedInput::QuantizeTrigger(triggerV);
+    } else {
+        QuantizedInput::QuantizeCombinedTrigger(triggerZ, &pInput->triggerL, &pInput->triggerR);
+    }
+
+    if (s_deterministic) {
+        // _[hFʎqς݂̒l琶
+        pState->leftStickX = (float)pInput->leftStickX / 127.0f;
+        pState->leftStickY = (float)pInput->leftStickY / 127.0f;
+        pState->rightStickX = (float)pInput->rightStickX / 127.0f;
+        pState->rightStickY = (float)pInput->rightStickY / 127.0f;
+        pState->triggerL = (float)pInput->triggerL / 255.0f;
+        pState->triggerR = (float)pInput->triggerR / 255.0f;
+    } else {
+        // XeBbNl𐳋Ki-1.0 1.0j
+        pState->leftStickX = (float)(leftX - 32767) / 32767.0f;
+        pState->leftStickY = (float)(leftY - 32767) / 32767.0f;
+        pState->rightStickX = (float)(rightX - 32767) / 32767.0f;
+        pState->rightStickY = (float)(rightY - 32767) / 32767.0f;
+
+        // 肵Ŝ␳
+        pState->leftStickX = GamepadState::ApplyCenter(pState->leftStickX, left.centerX);
+        pState->leftStickY = GamepadState::ApplyCenter(pState->leftStickY, left.centerY);
+        pState->rightStickX = GamepadState::ApplyCenter(pState->rightStickX, right.centerX);
+        pState->rightStickY = GamepadState::ApplyCenter(pState->rightStickY, right.centerY);
+
+        // fbh][Kp
+        pState->leftStickX = GamepadState::ApplyDeadzone(pState->leftStickX, left.deadzone);
+        pState->leftStickY = GamepadState::ApplyDeadzone(pState->leftStickY, left.deadzone);
+        pState->rightStickX = GamepadState::ApplyDeadzone(pState->rightStickX, right.deadzone);
+        pState->rightStickY = GamepadState::ApplyDeadzone(pState->rightStickY, right.deadzone);
+
+        // gK[l𐳋K
+        // ꕔRg[[L2/R21̎iZjɍZĂ
+        if (s_caps.hasV) {
+            // ZVʁXɂꍇiXInputRg[[Ȃǁj
+            pState->triggerL = (float)triggerZ / 65535.0f;
+            pState->triggerR = (float)triggerV / 65535.0f;
+        } else {
+            // Ẑ݂̏ꍇiDirectInputRg[[Ȃǁj
+            // 32767íjA65535L2A0R2
+            const int CENTER = 32767;
+            const int DEADZONE = 1000;
+
+            if (triggerZ > CENTER + DEADZONE) {
+                // L2Ă
+                pState->triggerL = (float)(triggerZ - CENTER) / (float)(65535 - CENTER);
+                pState->triggerR = 0.0f;
+            } else if (triggerZ < CENTER - DEADZONE) {
+                // R2Ă
+                pState->triggerL = 0.0f;
+                pState->triggerR = (float)(CENTER - triggerZ) / (float)CENTER;
+            } else {
+                // 
+                pState->triggerL = 0.0f;
+                pState->triggerR = 0.0f;
+            }
+        }
+    }
+}
+
 // ԂXV
 bool GameController::UpdateState() {
     // Ot[̏Ԃۑ
     s_prevState = s_currentState;
 
+    // IXbhA񓯊Ŏ擾foCX𔽉f
+    ReapProbeThreads();
+    ApplyPendingCaps();
+
     // ڑ̃Rg[[ȂΒT
     if (s_workingControllerId == -1) {
-        for (int id = 0; id < 16; id++) {
-            int testValue = GetGamepadValue(id, 3);
-            if (testValue != -1) {
-                s_workingControllerId = id;
-                UpdateCaps(id);
-                break;
-            }
-        }
-
         // Ȃ
-        if (s_workingControllerId == -1) {
+        if (!FindController()) {
             s_currentState.connected = false;
             return false;
         }
     }
 
-    // e̒l擾
-    int leftX = GetGamepadValue(s_workingControllerId, 0);
-    int leftY = GetGamepadValue(s_workingControllerId, 1);
-    int rightX = GetGamepadValue(s_workingControllerId, 4);
-    int rightY = GetGamepadValue(s_workingControllerId, 5);
-    int triggerZ = GetGamepadValue(s_workingControllerId, 2);
-    int triggerV = GetGamepadValue(s_workingControllerId, 6);
-    int buttons = GetGamepadValue(s_workingControllerId, 3);
-    int pov = GetGamepadValue(s_workingControllerId, 8);
-
-    // ؒf`FbN
-    if (leftX == -1) {
+    // S̒l1Ŏ擾iؒf`FbN˂A͓ID玎j
+    JOYINFOEX ji;
+    if (!ReadRaw(s_workingControllerId, &ji)) {
+        s_cachedControllerId = s_workingControllerId;
+        s_cachedCaps = s_caps;
         s_workingControllerId = -1;
         s_currentState.connected = false;
         s_caps.valid = false;
@@ -114,89 +815,44 @@ bool GameController::UpdateState() {
     }
 
     s_currentState.connected = true;
+    QueryPerformanceCounter(&s_frameSampleTime);
+    s_latchSampleTime = s_frameSampleTime;
+
+    int buttons = (int)ji.dwButtons;
+    int pov = (int)ji.dwPOV;
+
+    // XeBbN̒S𐄒
+    if (s_driftCompensation) {
+        bool buttonsIdle = (buttons & 0xFFF) == 0 && (pov == 65535 || pov == -1);
+        UpdateDrift(&s_stickDrift[0], (int)ji.dwXpos, (int)ji.dwYpos, buttonsIdle);
+        UpdateDrift(&s_stickDrift[1], (int)ji.dwRpos, (int)ji.dwUpos, buttonsIdle);
+    }
 
-    // fobOpɒlۑ
-    s_currentState.axisLeftX = leftX;
-    s_currentState.axisLeftY = leftY;
-    s_currentState.axisRightX = rightX;
-    s_currentState.axisRightY = rightY;
-    s_currentState.axisTriggerL = triggerZ;
-    s_currentState.axisTriggerR = triggerV;
     s_currentState.buttonsRaw = buttons;
     s_currentState.povValue = pov;
 
-    // XeBbNl𐳋Ki-1.0 1.0j
-    s_currentState.leftStickX = (float)(leftX - 32767) / 32767.0f;
-    s_currentState.leftStickY = (float)(leftY - 32767) / 32767.0f;
-    s_currentState.rightStickX = (float)(rightX - 32767) / 32767.0f;
-    s_currentState.rightStickY = (float)(rightY - 32767) / 32767.0f;
+    // XeBbNEgK[̒lϊ
+    DecodeAxes(ji, &s_currentState, &s_currentInput);
 
-    // fbh][Kp
-    s_currentState.leftStickX = GamepadState::ApplyDeadzone(s_currentState.leftStickX);
-    s_currentState.leftStickY = GamepadState::ApplyDeadzone(s_currentState.leftStickY);
-    s_currentState.rightStickX = GamepadState::ApplyDeadzone(s_currentState.rightStickX);
-    s_currentState.rightStickY = GamepadState::ApplyDeadzone(s_currentState.rightStickY);
+    // {^̃rbg}XN쐬i0?11͐̃{^ԍƓсj
+    unsigned int mask = (unsigned int)buttons & 0xFFFu;
 
-    // gK[l𐳋K
-    // ꕔRg[[L2/R21̎iZjɍZĂ
-    if (s_caps.hasV) {
-        // ZVʁXɂꍇiXInputRg[[Ȃǁj
-        s_currentState.triggerL = (float)triggerZ / 65535.0f;
-        s_currentState.triggerR = (float)triggerV / 65535.0f;
-    } else {
-        // Ẑ݂̏ꍇiDirectInputRg[[Ȃǁj
-        // 32767íjA65535L2A0R2
-        const int CENTER = 32767;
-        const int DEADZONE = 1000;
-
-        if (triggerZ > CENTER + DEADZONE) {
-            // L2Ă
-            s_currentState.triggerL = (float)(triggerZ - CENTER) / (float)(65535 - CENTER);
-            s_currentState.triggerR = 0.0f;
-        } else if (triggerZ < CENTER - DEADZONE) {
-            // R2Ă
-            s_currentState.triggerL = 0.0f;
-            s_currentState.triggerR = (float)(CENTER - triggerZ) / (float)CENTER;
-        } else {
-            // 
-            s_currentState.triggerL = 0.0f;
-            s_currentState.triggerR = 0.0f;
-        }
-    }
+    // z{^igK[L2/R2܂ށj
+    mask |= EvaluateVirtualButtons(timeGetTime());
 
     // \L[̏
-    if (pov == 65535 || pov == -1) {
-        // 
-        s_currentState.dpadUp = false;
-        s_currentState.dpadDown = false;
-        s_currentState.dpadLeft = false;
-        s_currentState.dpadRight = false;
-    } else {
+    if (pov != 65535 && pov != -1) {
         // pxxɕϊi0.01xPʂȂ̂100Ŋj
         int angle = pov / 100;
-        s_currentState.dpadUp = (angle >= 315 || angle <= 45);
-        s_currentState.dpadRight = (angle >= 45 && angle <= 135);
-        s_currentState.dpadDown = (angle >= 135 && angle <= 225);
-        s_currentState.dpadLeft = (angle >= 225 && angle <= 315);
-    }
-
-    // {^̏
-    s_currentState.buttonDown = (buttons & (1 << 0)) != 0;  // {^0
-    s_currentState.buttonRight = (buttons & (1 << 1)) != 0;  // {^1
-    s_currentState.buttonLeft = (buttons & (1 << 2)) != 0;  // {^2
-    s_currentState.buttonUp = (buttons & (1 << 3)) != 0;  // {^3
-    s_currentState.buttonL1 = (buttons & (1 << 4)) != 0;  // {^4
-    s_currentState.buttonR1 = (buttons & (1 << 5)) != 0;  // {^5
-    s_currentState.buttonSelect = (buttons & (1 << 6)) != 0;  // {^6
-    s_currentState.buttonStart = (buttons & (1 << 7)) != 0;  // {^7
-    s_currentState.buttonL3 = (buttons & (1 << 8)) != 0;  // {^8
-    s_currentState.buttonR3 = (buttons & (1 << 9)) != 0;  // {^9
-    s_currentState.buttonExtra1 = (buttons & (1 << 10)) != 0; // {^10
-    s_currentState.buttonExtra2 = (buttons & (1 << 11)) != 0; // {^11
-
-    // gK[{^ƂĂi50%ȏŃIj
-    s_currentState.buttonL2 = (s_currentState.triggerL > 0.5f);
-    s_currentState.buttonR2 = (s_currentState.triggerR > 0.5f);
+        if (angle >= 315 || angle <= 45) mask |= 1u << GAMEPAD_BUTTON_DPAD_UP;
+        if (angle >= 45 && angle <= 135) mask |= 1u << GAMEPAD_BUTTON_DPAD_RIGHT;
+        if (angle >= 135 && angle <= 225) mask |= 1u << GAMEPAD_BUTTON_DPAD_DOWN;
+        if (angle >= 225 && angle <= 315) mask |= 1u << GAMEPAD_BUTTON_DPAD_LEFT;
+    }
+
+    // e{^ɔf
+    s_currentState.SetButtonMask(mask);
+    s_currentInput.buttons = mask;
 
     return true;
 }
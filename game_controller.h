@@ -6,9 +6,80 @@
 #include <windows.h>
 #include <mmsystem.h>
 #include <cmath>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #pragma comment(lib, "winmm.lib")
 
+// {^ԍi{^̃rbg}XÑrbgʒuj
+// 0?11joyGetPosEx̃{^ԍƓ
+enum GamepadButton {
+    GAMEPAD_BUTTON_DOWN = 0,    // AA~AB
+    GAMEPAD_BUTTON_RIGHT,       // BAAA
+    GAMEPAD_BUTTON_LEFT,        // XAAY
+    GAMEPAD_BUTTON_UP,          // YAAX
+    GAMEPAD_BUTTON_L1,
+    GAMEPAD_BUTTON_R1,
+    GAMEPAD_BUTTON_SELECT,
+    GAMEPAD_BUTTON_START,
+    GAMEPAD_BUTTON_L3,
+    GAMEPAD_BUTTON_R3,
+    GAMEPAD_BUTTON_EXTRA1,
+    GAMEPAD_BUTTON_EXTRA2,
+    GAMEPAD_BUTTON_L2,
+    GAMEPAD_BUTTON_R2,
+    GAMEPAD_BUTTON_DPAD_UP,
+    GAMEPAD_BUTTON_DPAD_DOWN,
+    GAMEPAD_BUTTON_DPAD_LEFT,
+    GAMEPAD_BUTTON_DPAD_RIGHT,
+    GAMEPAD_BUTTON_VIRTUAL0,    // z{^i琶AAddVirtualButtonŐݒj
+    GAMEPAD_BUTTON_VIRTUAL1,
+    GAMEPAD_BUTTON_VIRTUAL2,
+    GAMEPAD_BUTTON_VIRTUAL3,
+    GAMEPAD_BUTTON_VIRTUAL4,
+    GAMEPAD_BUTTON_VIRTUAL5,
+    GAMEPAD_BUTTON_VIRTUAL6,
+    GAMEPAD_BUTTON_VIRTUAL7,
+    GAMEPAD_BUTTON_COUNT
+};
+
+// z{^̓͌
+enum VirtualButtonSource {
+    VIRTUAL_SOURCE_LEFT_X = 0,
+    VIRTUAL_SOURCE_LEFT_Y,
+    VIRTUAL_SOURCE_RIGHT_X,
+    VIRTUAL_SOURCE_RIGHT_Y,
+    VIRTUAL_SOURCE_TRIGGER_L,
+    VIRTUAL_SOURCE_TRIGGER_R,
+    VIRTUAL_SOURCE_COUNT
+};
+
+// z{^̐ݒi̒lqXeVXtŃ{^ɕϊj
+struct VirtualButtonConfig {
+    // 蓖Ă{^iL2/R2≼z{^j
+    GamepadButton target = GAMEPAD_BUTTON_VIRTUAL0;
+
+    // ͌̎
+    VirtualButtonSource source = VIRTUAL_SOURCE_LEFT_X;
+
+    // ̌i1.0܂-1.0AXeBbN̏-1.0j
+    float direction = 1.0f;
+
+    // XeBbN\L[ƂĔ肷i0͎̒l̂܂܁A4܂8j
+    int stickWays = 0;
+
+    // IɂȂl
+    float pressThreshold = 0.5f;
+
+    // ItɂȂlipressThreshold菬j
+    float releaseThreshold = 0.4f;
+
+    // ŒIԁi~bj
+    unsigned int minHoldMs = 0;
+};
+
  // Rg[[̓͏
 struct GamepadState {
     // XeBbNi-1.0?1.0Afbh][Kpj
@@ -42,7 +113,7 @@ struct GamepadState {
     bool buttonL1 = false;
     bool buttonR1 = false;
 
-    // gK[{^iL2/R2ALT/RTj臒l50%ŃI
+    // gK[{^iL2/R2ALT/RTj50%ŃIA40%ŃItiz{^ŕύXj
     bool buttonL2 = false;
     bool buttonR2 = false;
 
@@ -61,6 +132,9 @@ struct GamepadState {
     // {^̃rbgtOifobOpj
     unsigned int buttonsRaw = 0;
 
+    // {^̃rbg}XNiGamepadButtonj
+    unsigned int buttonMask = 0;
+
     // ڑ
     bool connected = false;
 
@@ -82,16 +156,100 @@ struct GamepadState {
             dpadUp || dpadDown || dpadLeft || dpadRight;
     }
 
+    // w肵{^Ă邩
+    bool IsButtonPressed(GamepadButton button) const {
+        return (buttonMask & (1u << button)) != 0;
+    }
+
+    // rbg}XNe{^ݒ
+    void SetButtonMask(unsigned int mask) {
+        buttonMask = mask;
+        buttonDown = (mask & (1u << GAMEPAD_BUTTON_DOWN)) != 0;
+        buttonRight = (mask & (1u << GAMEPAD_BUTTON_RIGHT)) != 0;
+        buttonLeft = (mask & (1u << GAMEPAD_BUTTON_LEFT)) != 0;
+        buttonUp = (mask & (1u << GAMEPAD_BUTTON_UP)) != 0;
+        buttonL1 = (mask & (1u << GAMEPAD_BUTTON_L1)) != 0;
+        buttonR1 = (mask & (1u << GAMEPAD_BUTTON_R1)) != 0;
+        buttonSelect = (mask & (1u << GAMEPAD_BUTTON_SELECT)) != 0;
+        buttonStart = (mask & (1u << GAMEPAD_BUTTON_START)) != 0;
+        buttonL3 = (mask & (1u << GAMEPAD_BUTTON_L3)) != 0;
+        buttonR3 = (mask & (1u << GAMEPAD_BUTTON_R3)) != 0;
+        buttonExtra1 = (mask & (1u << GAMEPAD_BUTTON_EXTRA1)) != 0;
+        buttonExtra2 = (mask & (1u << GAMEPAD_BUTTON_EXTRA2)) != 0;
+        buttonL2 = (mask & (1u << GAMEPAD_BUTTON_L2)) != 0;
+        buttonR2 = (mask & (1u << GAMEPAD_BUTTON_R2)) != 0;
+        dpadUp = (mask & (1u << GAMEPAD_BUTTON_DPAD_UP)) != 0;
+        dpadDown = (mask & (1u << GAMEPAD_BUTTON_DPAD_DOWN)) != 0;
+        dpadLeft = (mask & (1u << GAMEPAD_BUTTON_DPAD_LEFT)) != 0;
+        dpadRight = (mask & (1u << GAMEPAD_BUTTON_DPAD_RIGHT)) != 0;
+    }
+
+    // Ŝ␳i[܂œ|ƂɁ}1.0ɂȂ悤БL΂j
+    static float ApplyCenter(float value, float center) {
+        float range = (value >= center) ? 1.0f - center : 1.0f + center;
+        return (value - center) / range;
+    }
+
     // fbh][Kp
     static float ApplyDeadzone(float value, float deadzone = 0.15f) {
         if (fabs(value) < deadzone) return 0.0f;
 
         float sign = (value > 0) ? 1.0f : -1.0f;
         float adjustedValue = (fabs(value) - deadzone) / (1.0f - deadzone);
+        if (adjustedValue > 1.0f) adjustedValue = 1.0f;
         return sign * adjustedValue;
     }
 };
 
+// ʎqς݂̓́ilbgvCE[obNpj
+// Ẑ݂Ő邽߁Aǂ̊łrbgPʂňv
+struct QuantizedInput {
+    // VACỸoCgi{^4oCg{XeBbN4oCg{gK[2oCgj
+    static const int SERIALIZED_SIZE = 10;
+
+    // XeBbÑfbh][i̒lA3276715%j
+    static const int STICK_DEADZONE = 4915;
+
+    // {^̃rbg}XNiGamepadButtonAz{^܂ށj
+    unsigned int buttons = 0;
+
+    // XeBbNi-127?127Afbh][Kpj
+    signed char leftStickX = 0;
+    signed char leftStickY = 0;
+    signed char rightStickX = 0;
+    signed char rightStickY = 0;
+
+    // gK[i0?255j
+    unsigned char triggerL = 0;
+    unsigned char triggerR = 0;
+
+    bool operator==(const QuantizedInput& other) const {
+        return buttons == other.buttons &&
+            leftStickX == other.leftStickX && leftStickY == other.leftStickY &&
+            rightStickX == other.rightStickX && rightStickY == other.rightStickY &&
+            triggerL == other.triggerL && triggerR == other.triggerR;
+    }
+    bool operator!=(const QuantizedInput& other) const { return !(*this == other); }
+
+    // oCgɏoi񂾃oCgԂj
+    int Serialize(unsigned char* pBuf) const;
+
+    // oCg񂩂ǂݍ
+    bool Deserialize(const unsigned char* pBuf, int size);
+
+    // GamepadStateɓWJi[gvC[̓͂Q[ɓnpj
+    void ToState(GamepadState* pState) const;
+
+    // XeBbN̐̒li0?65535jʎqiSƃfbh][͐̒lŎwj
+    static signed char QuantizeStick(int raw, int center = 32767, int deadzone = STICK_DEADZONE);
+
+    // gK[̐̒li0?65535jʎq
+    static unsigned char QuantizeTrigger(int raw);
+
+    // ZgK[iẐ݁j̐̒lʎq
+    static void QuantizeCombinedTrigger(int raw, unsigned char* pL, unsigned char* pR);
+};
+
 // Rg[[̃foCX
 struct GamepadCaps {
     // Lǂ
@@ -155,8 +313,111 @@ struct GamepadCaps {
     bool hasPov = false;
 };
 
+// XeBbN̒S̐
+// Î~i{^Ă炸l̂΂ԁj̒l璆SƂ΂߂
+struct StickDriftStats {
+    // 肵Ŝi-1.0?1.0j
+    float centerX = 0.0f;
+    float centerY = 0.0f;
+
+    // Î~̂΂iW΍j
+    float noise = 0.0f;
+
+    // ݂̃fbh][
+    float deadzone = 0.15f;
+
+    // Î~Ɣ肵Tv
+    unsigned int restSamples = 0;
+
+    // Î~Ă邩
+    bool resting = false;
+
+    // AĐÎ~Ăt[
+    unsigned int restFrames = 0;
+
+    // ߂̒l̕ςƕUiÎ~pj
+    float recentMeanX = 0.0f;
+    float recentMeanY = 0.0f;
+    float recentVariance = 0.0f;
+
+    // Î~̕U
+    float restVariance = 0.0f;
+};
+
+// xb`̕
+enum LatchMode {
+    LATCH_MODE_OFF = 0,     // t[Jn̒l̂܂ܕԂ
+    LATCH_MODE_RESAMPLE     // b`ɓǂݒŐV̒lԂ
+};
+
+// b`|CgƂ̌v
+struct LatchStats {
+    // b`|Cg
+    char name[32] = {};
+
+    // b`
+    unsigned int count = 0;
+
+    // ۂɃRg[[ǂݒ
+    unsigned int resampleCount = 0;
+
+    // t[Jn̒lgꍇ̌oߎԂ̍vi}CNbj
+    double totalFrameAgeUs = 0.0;
+
+    // ۂɕԂľoߎԂ̍vi}CNbj
+    double totalLatchedAgeUs = 0.0;
+
+    // 1ŒZkłoߎԂ̍ői}CNbj
+    double maxSavedUs = 0.0;
+
+    // 1񂠂ɒZkłoߎԂ̕ρi}CNbj
+    double GetAverageSavedUs() const {
+        return (count == 0) ? 0.0 : (totalFrameAgeUs - totalLatchedAgeUs) / count;
+    }
+};
+
 class GameController {
+public:
+    // z{^̍ő吔
+    static const int MAX_VIRTUAL_BUTTONS = 16;
+
+    // Rg[[ID̐
+    static const int MAX_CONTROLLERS = 16;
+
+    // Tp̃Xbh
+    static const int PROBE_WORKERS = 4;
+
+    // Tn߂t[Ōʂ҂ő厞ԁi~bj
+    static const unsigned int PROBE_DEADLINE_MS = 8;
+
+    // ȂƂɒTԊui~bj
+    static const unsigned int PROBE_INTERVAL_MS = 500;
+
+    // XeBbN̐i0:A1:Ej
+    static const int NUM_STICKS = 2;
+
+    // b`|Cg̍ő吔
+    static const int MAX_LATCH_POINTS = 8;
+
+    // VlΓǂݒȂi}CNbj
+    static const int LATCH_MIN_RESAMPLE_US = 500;
+
 private:
+    // z{^̔pf[^
+    struct VirtualButtonSlot {
+        unsigned int targetBit;     // 蓖Ă{^̃rbgʒu
+        int source;                 // ͌̎
+        int perpSource;             // 鎲iXeBbNpj
+        float direction;            // ̌
+        float axisWeight;           // ̒lgi1.0ŎA0.0ŃXeBbNj
+        float cosHalf;              // XeBbN͈̔́ipcosj
+        float pressThreshold;
+        float releaseThreshold;
+        unsigned int minHoldMs;
+        unsigned int pressTime;     // IɂȂ
+        unsigned int on;            // ݂̏ԁi0܂1j
+    };
+
     // ڑ̃Rg[[IDi-1͖ڑj
     static int s_workingControllerId;
 
@@ -169,29 +430,135 @@ private:
     // foCX
     static GamepadCaps s_caps;
 
+    // ݃t[̗ʎqςݓ
+    static QuantizedInput s_currentInput;
+
+    // _[hitrueȂ畂̒lʎqςݓ͂琶j
+    static bool s_deterministic;
+
+    // z{^
+    static VirtualButtonSlot s_virtualButtons[MAX_VIRTUAL_BUTTONS];
+    static int s_numVirtualButtons;
+
+    // z{^𔻒肵ărbg}XNԂ
+    static unsigned int EvaluateVirtualButtons(unsigned int now);
+
+    // TpXbh
+    static std::thread s_probeThreads[PROBE_WORKERS];
+
+    // ɒׂID
+    static std::atomic<int> s_probeNext;
+
+    // ׏IID̃rbgtO
+    static std::atomic<unsigned int> s_probeDoneMask;
+
+    // ĂTXbh̐
+    static std::atomic<int> s_probeRunning;
+
+    // Tʂ̑ҋ@pis_probeDoneMask̍XVʒmj
+    static std::mutex s_probeMutex;
+    static std::condition_variable s_probeCond;
+
+    // ID̃rbgtO
+    static std::atomic<unsigned int> s_probeFoundMask;
+
+    // ID̃foCXiTXbhށj
+    static GamepadCaps s_probeCaps[MAX_CONTROLLERS];
+
+    // T
+    static bool s_probing;
+
+    // Tʂgpς݂
+    static bool s_probeConsumed;
+
+    // ŌɒTn߂
+    static unsigned int s_probeStartTime;
+
+    // LbVt@C̃pXiȂLbVȂj
+    static char s_cachePath[MAX_PATH];
+
+    // LbVɂÕRg[[IDi-1͂Ȃj
+    static int s_cachedControllerId;
+
+    // LbVɂfoCX
+    static GamepadCaps s_cachedCaps;
+
+    // foCX̔񓯊擾
+    static std::thread s_capsThread;
+    static GamepadCaps s_pendingCaps;
+    static int s_pendingCapsId;
+    static std::atomic<bool> s_capsReady;
+
+    // XeBbN̒S␳
+    static bool s_driftCompensation;
+    static StickDriftStats s_stickDrift[NUM_STICKS];
+
+    // S̐XV
+    static void UpdateDrift(StickDriftStats* pDrift, int rawX, int rawY, bool buttonsIdle);
+
+    // xb`
+    static LatchMode s_latchMode;
+    static GamepadState s_latchedState;
+    static LatchStats s_latchStats[MAX_LATCH_POINTS];
+    static int s_numLatchPoints;
+
+    // t[Jnɓǂ񂾎ƁAŌɓǂ񂾎
+    static LARGE_INTEGER s_frameSampleTime;
+    static LARGE_INTEGER s_latchSampleTime;
+
+    // JE^1񂠂̃}CNbiInitialize()ŋ߂j
+    static double s_usPerTick;
+
+    // S̒l擾
+    static bool ReadRaw(int id, JOYINFOEX* pInfo);
+
+    // XeBbNEgK[̒lϊ
+    static void DecodeAxes(const JOYINFOEX& ji, GamepadState* pState, QuantizedInput* pInput);
+
     // w肵̒l擾
     static int GetGamepadValue(int id, int func);
 
     // ԂXV
     static bool UpdateState();
 
-    // foCXXV
-    static void UpdateCaps(int id);
+    // foCX擾
+    static bool QueryCaps(int id, GamepadCaps* pCaps);
+
+    // Rg[[T
+    static bool FindController();
+
+    // TXbh̏
+    static void ProbeWorker();
+
+    // SID̕TJn
+    static void StartProbe();
+
+    // TʂmFiőwaitMs~b҂AIDԂj
+    static int PollProbe(unsigned int waitMs);
+
+    // foCX̔񓯊擾Jn
+    static void StartCapsQuery(int id);
+
+    // 񓯊擾foCX𔽉f
+    static void ApplyPendingCaps();
+
+    // ITXbh
+    static void ReapProbeThreads();
+
+    // Xbh̏I҂
+    static void JoinThreads();
+
+    // LbV̓ǂݏ
+    static void LoadCache();
+    static void SaveCache();
 
 public:
     // 
-    static bool Initialize() {
-        s_workingControllerId = -1;
-        s_currentState = {};
-        s_prevState = {};
-        s_caps = {};
-        return true;
-    }
+    // pCachePathɃfoCX̃LbVt@Cwiȗ̓LbVȂj
+    static bool Initialize(const char* pCachePath = nullptr);
 
-    // t[Ă
-    static void Update() {
-        UpdateState();
-    }
+    // t[Ăԁi͑҂̃R[`ōĊJj
+    static void Update();
 
     // ݂̏Ԃ擾
     static const GamepadState& GetCurrentState() { return s_currentState; }
@@ -205,6 +572,37 @@ public:
     // Rg[[ID擾
     static int GetControllerId() { return s_workingControllerId; }
 
+    // ݃t[̗ʎqςݓ͂擾
+    static const QuantizedInput& GetQuantizedInput() { return s_currentInput; }
+
+    // _[h̐ݒ
+    // LɂƃXeBbNEgK[̒lʎqςݓ͂邽߁A
+    // lbgvCőSlg
+    static void SetDeterministicMode(bool enable) { s_deterministic = enable; }
+    static bool IsDeterministicMode() { return s_deterministic; }
+
+    // ========================================
+    // z{^i{^ƂĈj
+    // ========================================
+
+    // z{^ǉiԍԂA-1͎sj
+    static int AddVirtualButton(const VirtualButtonConfig& config);
+
+    // z{^̐ݒύX
+    // releaseThresholdpressThreshold傫AstickWays0/4/8ȊOȂfalse
+    static bool SetVirtualButton(int index, const VirtualButtonConfig& config);
+
+    // ̐ݒi0:L2A1:R2jɖ߂
+    static void ResetVirtualButtons();
+
+    // ========================================
+    // {^ԍw̔iz{^gj
+    // ========================================
+
+    static bool IsPressed(GamepadButton button) { return s_currentState.IsButtonPressed(button); }
+    static bool IsTrigger(GamepadButton button) { return s_currentState.IsButtonPressed(button) && !s_prevState.IsButtonPressed(button); }
+    static bool IsRelease(GamepadButton button) { return !s_currentState.IsButtonPressed(button) && s_prevState.IsButtonPressed(button); }
+
     // ========================================
     // PressiĂԂtruej
     // ========================================
@@ -323,6 +721,43 @@ public:
     static float GetTriggerL() { return s_currentState.triggerL; }
     static float GetTriggerR() { return s_currentState.triggerR; }
 
+    // ========================================
+    // XeBbN̒S␳
+    // ========================================
+
+    // ␳̐ݒiɂƒS0Afbh][0.15ɖ߂j
+    static void SetDriftCompensation(bool enable);
+    static bool IsDriftCompensation() { return s_driftCompensation; }
+
+    // 蒼
+    static void ResetDriftEstimate();
+
+    // Ԃ擾i0:XeBbNA1:EXeBbNj
+    static const StickDriftStats& GetDriftStats(int stick) { return s_stickDrift[stick]; }
+
+    // ========================================
+    // xb`iJEƏȂǕ\OɎglj
+    // ========================================
+
+    // ̐ݒ
+    static void SetLatchMode(LatchMode mode) { s_latchMode = mode; }
+    static LatchMode GetLatchMode() { return s_latchMode; }
+
+    // b`|Cgo^iԍԂA-1͎sj
+    static int RegisterLatchPoint(const char* pName);
+
+    // ŐV̏Ԃ擾
+    // XeBbNEgK[ǂݒA{^Trigger/Release̓t[Jn̂܂
+    // Q[WbNGetCurrentState()̒lgAŎl͕\pɎg
+    static const GamepadState& Latch(int latchId);
+
+    // vʂ擾
+    static const LatchStats& GetLatchStats(int latchId) { return s_latchStats[latchId]; }
+    static int GetLatchPointCount() { return s_numLatchPoints; }
+
+    // vʂZbg
+    static void ResetLatchStats();
+
     // ========================================
     // ڑ
     // ========================================
@@ -330,11 +765,6 @@ public:
     // Rg[[ڑĂ邩
     static bool IsConnected() { return s_currentState.connected; }
 
-    // I
-    static void Finalize() {
-        s_workingControllerId = -1;
-        s_currentState = {};
-        s_prevState = {};
-        s_caps = {};
-    }
-};
\ No newline at end of file
+    // IiT̃Xbh̏I҂j
+    static void Finalize();
+};
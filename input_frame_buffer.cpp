@@ -0,0 +1,126 @@
+/*********************************************************************
+ * \file   input_frame_buffer.cpp
+ * \brief  [obNp̓̓t[obt@
+ *********************************************************************/
+#include "input_frame_buffer.h"
+
+// 
+void InputFrameBuffer::Reset() {
+    for (int player = 0; player < MAX_PLAYERS; player++) {
+        for (int i = 0; i < CAPACITY; i++) {
+            m_frames[player][i] = {};
+        }
+        m_lastConfirmedFrame[player] = -1;
+        m_contiguousFrame[player] = -1;
+        m_lastConfirmedInput[player] = {};
+    }
+    m_rollbackFrame = -1;
+}
+
+// m͂ǉ
+bool InputFrameBuffer::AddInput(int player, int frame, const QuantizedInput& input) {
+    if (player < 0 || player >= MAX_PLAYERS || frame < 0) return false;
+
+    InputFrame& slot = GetSlot(player, frame);
+
+    // t[Ɋmς݁iđȂǁj
+    if (slot.frame == frame && slot.confirmed) return true;
+
+    // ێ͈͂Ât[ƁA܂gĂXbg㏑̃t[͎󂯕tȂ
+    if (!IsInWindow(player, frame)) return false;
+
+    // \OĂ烍[obNΏ
+    if (slot.frame == frame && slot.input != input) {
+        if (m_rollbackFrame == -1 || frame < m_rollbackFrame) {
+            m_rollbackFrame = frame;
+        }
+    }
+
+    slot.frame = frame;
+    slot.input = input;
+    slot.confirmed = true;
+
+    if (frame > m_lastConfirmedFrame[player]) {
+        m_lastConfirmedFrame[player] = frame;
+        m_lastConfirmedInput[player] = input;
+    }
+
+    // r؂ꂸɊm肵Ă͈͂i߂
+    while (IsConfirmed(player, m_contiguousFrame[player] + 1)) {
+        m_contiguousFrame[player]++;
+    }
+    return true;
+}
+
+// ͂擾
+QuantizedInput InputFrameBuffer::GetInput(int player, int frame) {
+    if (player < 0 || player >= MAX_PLAYERS) return QuantizedInput();
+
+    InputFrame& slot = GetSlot(player, frame);
+    if (slot.frame == frame && slot.confirmed) return slot.input;
+
+    // ͈͊ÕXbg͑̃t[gĂ̂ŏȂ
+    if (!IsInWindow(player, frame)) return m_lastConfirmedInput[player];
+
+    // Ō̊m͂̂܂܎giăV~[V͗\j
+    slot.frame = frame;
+    slot.input = m_lastConfirmedInput[player];
+    slot.confirmed = false;
+    return slot.input;
+}
+
+// SvC[0r؂ꂸɊm肵ĂŐVt[擾
+int InputFrameBuffer::GetConfirmedFrame(int numPlayers) const {
+    int result = -1;
+    for (int player = 0; player < numPlayers && player < MAX_PLAYERS; player++) {
+        if (player == 0 || m_contiguousFrame[player] < result) {
+            result = m_contiguousFrame[player];
+        }
+    }
+    return result;
+}
+
+// m͂Aďo
+int InputFrameBuffer::Serialize(int player, int startFrame, int count, unsigned char* pBuf, int bufSize) const {
+    if (player < 0 || player >= MAX_PLAYERS) return 0;
+    if (count <= 0 || count > 255 || count > CAPACITY) return 0;
+    if (bufSize < 5 + count * QuantizedInput::SERIALIZED_SIZE) return 0;
+
+    // St[mς݂łȂΑȂ
+    for (int i = 0; i < count; i++) {
+        if (!IsConfirmed(player, startFrame + i)) return 0;
+    }
+
+    pBuf[0] = (unsigned char)(startFrame & 0xFF);
+    pBuf[1] = (unsigned char)((startFrame >> 8) & 0xFF);
+    pBuf[2] = (unsigned char)((startFrame >> 16) & 0xFF);
+    pBuf[3] = (unsigned char)((startFrame >> 24) & 0xFF);
+    pBuf[4] = (unsigned char)count;
+
+    int offset = 5;
+    for (int i = 0; i < count; i++) {
+        offset += GetSlot(player, startFrame + i).input.Serialize(pBuf + offset);
+    }
+    return offset;
+}
+
+// SerializeoCgm͂ƂĒǉ
+int InputFrameBuffer::Deserialize(int player, const unsigned char* pBuf, int size) {
+    if (size < 5) return 0;
+
+    int startFrame = (int)((unsigned int)pBuf[0] | ((unsigned int)pBuf[1] << 8) |
+        ((unsigned int)pBuf[2] << 16) | ((unsigned int)pBuf[3] << 24));
+    int count = pBuf[4];
+    if (count > CAPACITY) return 0;
+    if (size < 5 + count * QuantizedInput::SERIALIZED_SIZE) return 0;
+
+    int added = 0;
+    int offset = 5;
+    for (int i = 0; i < count; i++) {
+        QuantizedInput input;
+        input.Deserialize(pBuf + offset, size - offset);
+        offset += QuantizedInput::SERIALIZED_SIZE;
+        if (AddInput(player, startFrame + i, input)) added++;
+    }
+    return added;
+}
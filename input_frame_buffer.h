@@ -0,0 +1,99 @@
+/*********************************************************************
+ * \file   input_frame_buffer.h
+ * \brief  [obNp̓̓t[obt@
+ *********************************************************************/
+#pragma once
+#include "game_controller.h"
+
+// 1t[̓
+struct InputFrame {
+    // t[ԍi-1͋j
+    int frame = -1;
+
+    // 
+    QuantizedInput input;
+
+    // mς݂ifalseȂ\lj
+    bool confirmed = false;
+};
+
+// vC[Ƃ̓͂t[ԍŊǗ郊Oobt@
+// m̃t[͍Ō̊m͂ŗ\A
+// ォ͂m͂ƐHႦ΃[obNJnt[L^
+// t[ԍ0n߁Ar؂ꂸɊm肵ŐVt[CAPACITY܂ł
+class InputFrameBuffer {
+public:
+    // ővC[
+    static const int MAX_PLAYERS = 4;
+
+    // ێt[i2ׂ̂j
+    static const int CAPACITY = 128;
+
+private:
+    // ́i[vC[][t[ԍ & (CAPACITY - 1)]j
+    InputFrame m_frames[MAX_PLAYERS][CAPACITY];
+
+    // ŌɊm肵t[ԍi-1͖mj
+    int m_lastConfirmedFrame[MAX_PLAYERS];
+
+    // 0r؂ꂸɊm肵ĂŐVt[ԍi-1͖mj
+    int m_contiguousFrame[MAX_PLAYERS];
+
+    // ŌɊm肵́i\Ɏgj
+    QuantizedInput m_lastConfirmedInput[MAX_PLAYERS];
+
+    // \OꂽłÂt[i-1͂Ȃj
+    int m_rollbackFrame;
+
+    // Xbg擾
+    InputFrame& GetSlot(int player, int frame) { return m_frames[player][frame & (CAPACITY - 1)]; }
+    const InputFrame& GetSlot(int player, int frame) const { return m_frames[player][frame & (CAPACITY - 1)]; }
+
+    // XbgĂ悢t[ir؂ꂸɊm肵͈͂ŁACAPACITYj
+    bool IsInWindow(int player, int frame) const {
+        return frame > m_contiguousFrame[player] && frame < m_contiguousFrame[player] + CAPACITY;
+    }
+
+public:
+    InputFrameBuffer() { Reset(); }
+
+    // 
+    void Reset();
+
+    // m͂ǉi\ƈقȂ΃[obNΏۂɂj
+    // r؂ꂸɊm肵t[CAPACITYȏ̃t[ƁAێ͈͂Ât[Ȃfalse
+    bool AddInput(int player, int frame, const QuantizedInput& input);
+
+    // ͂擾imȂ\lL^ĕԂAvC[ԍ͈͊OȂ̓́j
+    // ͈͊Õt[͋L^ɍŌ̊m͂Ԃ
+    QuantizedInput GetInput(int player, int frame);
+
+    // mς݂
+    bool IsConfirmed(int player, int frame) const {
+        if (player < 0 || player >= MAX_PLAYERS) return false;
+        const InputFrame& slot = GetSlot(player, frame);
+        return slot.frame == frame && slot.confirmed;
+    }
+
+    // ŌɊm肵t[ԍ擾irɖm̃t[cĂ邱Ƃj
+    int GetLastConfirmedFrame(int player) const {
+        if (player < 0 || player >= MAX_PLAYERS) return -1;
+        return m_lastConfirmedFrame[player];
+    }
+
+    // SvC[0r؂ꂸɊm肵ĂŐVt[擾
+    int GetConfirmedFrame(int numPlayers) const;
+
+    // [obNJnt[擾i-1͕svj
+    int GetRollbackFrame() const { return m_rollbackFrame; }
+
+    // ăV~[VIĂ
+    void ClearRollback() { m_rollbackFrame = -1; }
+
+    // m͂Aďoi񂾃oCgԂA0͎sj
+    // `FJnt[4oCgAt[1oCgAȍ~1t[ƂQuantizedInput
+    int Serialize(int player, int startFrame, int count, unsigned char* pBuf, int bufSize) const;
+
+    // SerializeoCgm͂ƂĒǉiǉt[Ԃj
+    int Deserialize(int player, const unsigned char* pBuf, int size);
+};
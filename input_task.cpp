@@ -0,0 +1,172 @@
+/*********************************************************************
+ * \file   input_task.cpp
+ * \brief  R[`œ͂҂߂̃^XNiC++20j
+ *********************************************************************/
+#include "input_task.h"
+#include <bit>
+
+// ÓIoϐ̒`
+InputWaitNode* InputAwait::s_pressWaiters[GAMEPAD_BUTTON_COUNT] = {};
+InputWaitNode* InputAwait::s_releaseWaiters[GAMEPAD_BUTTON_COUNT] = {};
+InputAwaiter* InputAwait::s_timerWaiters = nullptr;
+
+// ׂẴXgO
+void InputAwaiter::Cancel() {
+    for (int i = 0; i < m_numNodes; i++) {
+        if (m_pNodes[i].ppHead != nullptr) InputAwait::Unlink(&m_pNodes[i]);
+    }
+    if (m_inTimer) InputAwait::UnlinkTimer(this);
+
+    // hNX̃m[h͔jς݂ɂȂ̂œxƐGȂ
+    m_numNodes = 0;
+}
+
+// fđҋ@o^
+void InputAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    m_handle = handle;
+    InputAwait::Register(this, timeGetTime());
+}
+
+// Xg̐擪ɒǉ
+void InputAwait::Link(InputWaitNode** ppHead, InputWaitNode* pNode) {
+    pNode->ppHead = ppHead;
+    pNode->pPrev = nullptr;
+    pNode->pNext = *ppHead;
+    if (*ppHead != nullptr) (*ppHead)->pPrev = pNode;
+    *ppHead = pNode;
+}
+
+// XgO
+void InputAwait::Unlink(InputWaitNode* pNode) {
+    if (pNode->pPrev != nullptr) pNode->pPrev->pNext = pNode->pNext;
+    else *pNode->ppHead = pNode->pNext;
+    if (pNode->pNext != nullptr) pNode->pNext->pPrev = pNode->pPrev;
+
+    pNode->pPrev = nullptr;
+    pNode->pNext = nullptr;
+    pNode->ppHead = nullptr;
+}
+
+// ԑ҂XgɊŒǉ
+void InputAwait::LinkTimer(InputAwaiter* pWaiter) {
+    InputAwaiter* pPrev = nullptr;
+    InputAwaiter* pNext = s_timerWaiters;
+    while (pNext != nullptr && (int)(pNext->m_deadline - pWaiter->m_deadline) <= 0) {
+        pPrev = pNext;
+        pNext = pNext->m_pTimerNext;
+    }
+
+    pWaiter->m_pTimerPrev = pPrev;
+    pWaiter->m_pTimerNext = pNext;
+    if (pPrev != nullptr) pPrev->m_pTimerNext = pWaiter;
+    else s_timerWaiters = pWaiter;
+    if (pNext != nullptr) pNext->m_pTimerPrev = pWaiter;
+    pWaiter->m_inTimer = true;
+}
+
+// ԑ҂XgO
+void InputAwait::UnlinkTimer(InputAwaiter* pWaiter) {
+    if (pWaiter->m_pTimerPrev != nullptr) pWaiter->m_pTimerPrev->m_pTimerNext = pWaiter->m_pTimerNext;
+    else s_timerWaiters = pWaiter->m_pTimerNext;
+    if (pWaiter->m_pTimerNext != nullptr) pWaiter->m_pTimerNext->m_pTimerPrev = pWaiter->m_pTimerPrev;
+
+    pWaiter->m_pTimerPrev = nullptr;
+    pWaiter->m_pTimerNext = nullptr;
+    pWaiter->m_inTimer = false;
+}
+
+// ҋ@̓o^
+void InputAwait::Register(InputAwaiter* pWaiter, unsigned int now) {
+    InputWaitNode* pNode = &pWaiter->m_node;
+    switch (pWaiter->m_kind) {
+    case InputAwaiter::KIND_PRESS:
+        Link(&s_pressWaiters[pNode->button], pNode);
+        break;
+    case InputAwaiter::KIND_RELEASE:
+        Link(&s_releaseWaiters[pNode->button], pNode);
+        break;
+    case InputAwaiter::KIND_HOLD:
+        // ɉĂ΂玞Ԃ𐔂
+        if (GameController::IsPressed(pNode->button)) {
+            pWaiter->m_deadline = now + pWaiter->m_holdMs;
+            Link(&s_releaseWaiters[pNode->button], pNode);
+            LinkTimer(pWaiter);
+        } else {
+            Link(&s_pressWaiters[pNode->button], pNode);
+        }
+        break;
+    case InputAwaiter::KIND_ANY:
+        // ҂{^ꂼ̃XgɂȂ
+        for (int i = 0; i < pWaiter->m_numNodes; i++) {
+            Link(&s_pressWaiters[pWaiter->m_pNodes[i].button], &pWaiter->m_pNodes[i]);
+        }
+        break;
+    }
+}
+
+// ҋ@̃R[`ĊJ
+// ͂ω{^̃XgƊ؂̎ԑ҂𒲂ׂ
+void InputAwait::Dispatch(unsigned int current, unsigned int previous, unsigned int now) {
+    unsigned int pressed = current & ~previous;
+    unsigned int released = previous & ~current;
+
+    // ĊĴW߂ĂĊJiĊJɓo^ꂽҋ@͎񂩂Ώہj
+    InputWaitNode* pReady = nullptr;
+
+    // uԁiԍ̏{^璲ׂ̂ŁAKIND_ANY͔ԍ̏̂ōĊJj
+    for (unsigned int bits = pressed; bits != 0; bits &= bits - 1) {
+        int button = std::countr_zero(bits);
+        while (InputWaitNode* pNode = s_pressWaiters[button]) {
+            InputAwaiter* pWaiter = pNode->pOwner;
+            Unlink(pNode);
+            if (pWaiter->m_kind == InputAwaiter::KIND_HOLD) {
+                // ĂԂ͗̂Ɗ҂
+                pWaiter->m_deadline = now + pWaiter->m_holdMs;
+                Link(&s_releaseWaiters[button], pNode);
+                LinkTimer(pWaiter);
+            } else {
+                if (pWaiter->m_kind == InputAwaiter::KIND_ANY) {
+                    // ̃{^̃XgO
+                    for (int i = 0; i < pWaiter->m_numNodes; i++) {
+                        if (pWaiter->m_pNodes[i].ppHead != nullptr) Unlink(&pWaiter->m_pNodes[i]);
+                    }
+                }
+                pWaiter->m_result = (GamepadButton)button;
+                Link(&pReady, &pWaiter->m_pNodes[0]);
+            }
+        }
+    }
+
+    // u
+    for (unsigned int bits = released; bits != 0; bits &= bits - 1) {
+        int button = std::countr_zero(bits);
+        while (InputWaitNode* pNode = s_releaseWaiters[button]) {
+            InputAwaiter* pWaiter = pNode->pOwner;
+            Unlink(pNode);
+            if (pWaiter->m_kind == InputAwaiter::KIND_HOLD) {
+                // rŗ̂ŉƂ납蒼
+                UnlinkTimer(pWaiter);
+                Link(&s_pressWaiters[button], pNode);
+            } else {
+                pWaiter->m_result = (GamepadButton)button;
+                Link(&pReady, pNode);
+            }
+        }
+    }
+
+    // Ċ
+    while (s_timerWaiters != nullptr && (int)(now - s_timerWaiters->m_deadline) >= 0) {
+        InputAwaiter* pWaiter = s_timerWaiters;
+        UnlinkTimer(pWaiter);
+        Unlink(&pWaiter->m_node);
+        pWaiter->m_result = pWaiter->m_node.button;
+        Link(&pReady, &pWaiter->m_node);
+    }
+
+    // ĊJiĊJR[`̃^XNjĂAjꂽ̂pReadyOj
+    while (pReady != nullptr) {
+        InputAwaiter* pWaiter = pReady->pOwner;
+        Unlink(pReady);
+        pWaiter->m_handle.resume();
+    }
+}
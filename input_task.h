@@ -0,0 +1,180 @@
+/*********************************************************************
+ * \file   input_task.h
+ * \brief  R[`œ͂҂߂̃^XNiC++20j
+ *********************************************************************/
+#pragma once
+#include <coroutine>
+#include <exception>
+#include "game_controller.h"
+
+// ͑҂̃R[`s^XN
+// ŏco_await܂ł͂ɎsAȍ~GameController::Update()ōĊJ
+// ^XNjƑҋ@̃R[`j
+class InputTask {
+public:
+    struct promise_type {
+        InputTask get_return_object() { return InputTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+
+public:
+    InputTask() = default;
+    explicit InputTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    InputTask(InputTask&& other) noexcept : m_handle(other.m_handle) { other.m_handle = nullptr; }
+    InputTask& operator=(InputTask&& other) noexcept {
+        if (this != &other) {
+            if (m_handle) m_handle.destroy();
+            m_handle = other.m_handle;
+            other.m_handle = nullptr;
+        }
+        return *this;
+    }
+    InputTask(const InputTask&) = delete;
+    InputTask& operator=(const InputTask&) = delete;
+    ~InputTask() { if (m_handle) m_handle.destroy(); }
+
+    // Ō܂Ŏs
+    bool IsDone() const { return !m_handle || m_handle.done(); }
+};
+
+class InputAwaiter;
+
+// ҋ@Xg̃m[hi1̑ҋ@̃{^̃XgɂȂ邱Ƃj
+struct InputWaitNode {
+    InputWaitNode* pPrev = nullptr;
+    InputWaitNode* pNext = nullptr;
+    InputWaitNode** ppHead = nullptr;
+
+    // ̃m[hҋ@
+    InputAwaiter* pOwner = nullptr;
+
+    // ҂Ă{^
+    GamepadButton button = GAMEPAD_BUTTON_COUNT;
+};
+
+// ͑҂ico_await̑Ώہj
+// ҋ@̓{^Ƃ̃XgɂȂA͂ωƂׂ
+class InputAwaiter {
+public:
+    // ҂
+    enum Kind {
+        KIND_PRESS,     // u
+        KIND_RELEASE,   // u
+        KIND_HOLD,      // w莞ԉ
+        KIND_ANY        // ꂩu
+    };
+
+private:
+    friend class InputAwait;
+
+    Kind m_kind;
+    unsigned int m_holdMs;
+
+    // ʁiĊJ̌ɂȂ{^j
+    GamepadButton m_result = GAMEPAD_BUTTON_COUNT;
+
+    // ҋ@Xg̃m[hiKIND_ANY͑҂{^̐AȊOm_node1j
+    // ĊJ҂̃Xgɂm_pNodes[0]Ȃ
+    InputWaitNode m_node;
+    InputWaitNode* m_pNodes;
+    int m_numNodes;
+
+    // ԑ҂XgiKIND_HOLDŉĂԂAj
+    InputAwaiter* m_pTimerPrev = nullptr;
+    InputAwaiter* m_pTimerNext = nullptr;
+    bool m_inTimer = false;
+    unsigned int m_deadline = 0;
+
+    std::coroutine_handle<> m_handle;
+
+protected:
+    // {^Ƃ̃m[hgiKIND_ANYpAm[h͔̏hNXōsj
+    InputAwaiter(InputWaitNode* pNodes, int numNodes)
+        : m_kind(KIND_ANY), m_holdMs(0), m_pNodes(pNodes), m_numNodes(numNodes) {}
+
+    // ׂẴXgO
+    void Cancel();
+
+public:
+    InputAwaiter(Kind kind, GamepadButton button, unsigned int holdMs)
+        : m_kind(kind), m_holdMs(holdMs), m_pNodes(&m_node), m_numNodes(1) {
+        m_node.pOwner = this;
+        m_node.button = button;
+    }
+    InputAwaiter(const InputAwaiter&) = delete;
+    InputAwaiter& operator=(const InputAwaiter&) = delete;
+
+    // R[`Ɣjꂽ烊XgO
+    ~InputAwaiter() { Cancel(); }
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> handle);
+    GamepadButton await_resume() const { return m_result; }
+};
+
+// ꂩ܂ł̑҂i{^ƂɃm[hj
+template <int N>
+class InputAnyAwaiter : public InputAwaiter {
+private:
+    InputWaitNode m_anyNodes[N];
+
+public:
+    explicit InputAnyAwaiter(const GamepadButton (&buttons)[N]) : InputAwaiter(m_anyNodes, N) {
+        for (int i = 0; i < N; i++) {
+            m_anyNodes[i].pOwner = this;
+            m_anyNodes[i].button = buttons[i];
+        }
+    }
+
+    // m[hɔĵŁAŃXgO
+    ~InputAnyAwaiter() { Cancel(); }
+};
+
+// ͑҂̍쐬ƍĊJ
+class InputAwait {
+private:
+    // ̂҂Ă郊XgiKIND_PRESSAOKIND_HOLDAKIND_ANYj
+    static InputWaitNode* s_pressWaiters[GAMEPAD_BUTTON_COUNT];
+
+    // ̂҂Ă郊XgiKIND_RELEASEAĂԂKIND_HOLDj
+    static InputWaitNode* s_releaseWaiters[GAMEPAD_BUTTON_COUNT];
+
+    // ԑ҂Xgȋj
+    static InputAwaiter* s_timerWaiters;
+
+    static void Link(InputWaitNode** ppHead, InputWaitNode* pNode);
+    static void Unlink(InputWaitNode* pNode);
+    static void LinkTimer(InputAwaiter* pWaiter);
+    static void UnlinkTimer(InputAwaiter* pWaiter);
+
+    // ҋ@̓o^
+    static void Register(InputAwaiter* pWaiter, unsigned int now);
+
+    friend class InputAwaiter;
+
+public:
+    // ɉ܂ő҂
+    static InputAwaiter NextPress(GamepadButton button) { return InputAwaiter(InputAwaiter::KIND_PRESS, button, 0); }
+
+    // ɗ܂ő҂
+    static InputAwaiter NextRelease(GamepadButton button) { return InputAwaiter(InputAwaiter::KIND_RELEASE, button, 0); }
+
+    // w莞ԁi~bj܂ő҂irŗŏj
+    static InputAwaiter HoldFor(GamepadButton button, unsigned int ms) { return InputAwaiter(InputAwaiter::KIND_HOLD, button, ms); }
+
+    // ꂩ܂ő҂i{^ԂAɉԍ̏́j
+    template <class... Buttons>
+    static InputAnyAwaiter<sizeof...(Buttons)> AnyOf(Buttons... buttons) {
+        const GamepadButton list[] = { (GamepadButton)buttons... };
+        return InputAnyAwaiter<sizeof...(Buttons)>(list);
+    }
+
+    // ͂̕ωƊ؂ɉđҋ@̃R[`ĊJiGameController::Update()Ă΂j
+    static void Dispatch(unsigned int current, unsigned int previous, unsigned int now);
+};
@@ -120,8 +120,8 @@ int main() {
 
         const char* pBtnL1 = state.buttonL1 ? "[L1]" : " L1 ";
         const char* pBtnR1 = state.buttonR1 ? "[R1]" : " R1 ";
-        const char* pBtnL2 = state.triggerL > 0.5f ? "[L2]" : " L2 ";
-        const char* pBtnR2 = state.triggerR > 0.5f ? "[R2]" : " R2 ";
+        const char* pBtnL2 = state.buttonL2 ? "[L2]" : " L2 ";
+        const char* pBtnR2 = state.buttonR2 ? "[R2]" : " R2 ";
         const char* pBtnL3 = state.buttonL3 ? "[L3]" : " L3 ";
         const char* pBtnR3 = state.buttonR3 ? "[R3]" : " R3 ";
 